@@ -4,13 +4,29 @@
 #define BIT_WORD_SIZE 31
 
 
+#if defined(__arm__) || defined(__thumb__)
 extern uint32_t CntLeadZeros(uint32_t word);
 extern uint32_t CntTrailZeros(uint32_t word);
+#else
+//
+// Fora do ARM (ex. shim de LD_PRELOAD em x86) usa os builtins
+// do compilador no lugar do bits_a.S:
+//
+static uint32_t CntLeadZeros(uint32_t word)
+{
+	return(word ? __builtin_clz(word) : 32);
+}
+
+static uint32_t CntTrailZeros(uint32_t word)
+{
+	return(word ? __builtin_ctz(word) : 32);
+}
+#endif
 
 //
-// ffs()
+// uffs()
 //
-uint32_t ffs(uint32_t word)
+uint32_t uffs(uint32_t word)
 {
 	//
 	// Adiciona o offset de delimitacao de word ao parametro
@@ -20,13 +36,16 @@ uint32_t ffs(uint32_t word)
 }
 
 //
-// fls()
+// ufls()
 //
-uint32_t fls(uint32_t word)
+uint32_t ufls(uint32_t word)
 {
 	//
-	// Assim basta aplicar a mesma metodologia do ffs:
+	// A contagem de zeros a direita ja e a posicao do bit
+	// menos significativo, word nulo retorna -1 como o uffs.
+	// O antigo BIT_WORD_SIZE - CntTrailZeros() devolvia o bit
+	// espelhado, e o FIND_SUITABLE_BLOCK indexava a lista errada:
 	//
-	return(BIT_WORD_SIZE - CntTrailZeros(word));
+	if(word == 0) return((uint32_t) -1);
+	return(CntTrailZeros(word));
 }
-
@@ -0,0 +1,94 @@
+//
+// @file frag_replay.c
+// @brief Replay de fragmentacao para o uMallocHint(): a mesma carga
+//        de blocos curtos com alguns longos espalhados roda sem dica
+//        e com LIFETIME_LONG, e mede o maior bloco livre depois que
+//        todos os curtos sao liberados.
+//
+//        Build:
+//        cc -O2 frag_replay.c tlsf.c bits.c -o frag_replay
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "tlsf.h"
+
+#define HEAP_SIZE								(4 * 1024 * 1024)
+#define SHORT_SLOTS							(2000)
+#define LONG_SLOTS							(3000)
+#define REPLAY_OPS							(400000)
+
+static uint8_t heap[HEAP_SIZE] __attribute__((aligned(16)));
+static void *short_live[SHORT_SLOTS];
+static void *long_live[LONG_SLOTS];
+
+//
+// next_rand(), xorshift para a carga ser igual nos tres modos
+//
+static uint32_t rnd;
+static uint32_t next_rand(void)
+{
+	rnd ^= rnd << 13;
+	rnd ^= rnd >> 17;
+	rnd ^= rnd << 5;
+	return rnd;
+}
+
+//
+// replay(): os longos usam hint, os curtos sempre LIFETIME_SHORT
+//
+static void replay(const char *name, int32_t hint)
+{
+	uint32_t i, slot, longs = 0;
+
+	rnd = 2463534242u;
+	memset(short_live, 0, sizeof(short_live));
+	memset(long_live, 0, sizeof(long_live));
+	uHeapReset();
+
+	for(i = 0; i < REPLAY_OPS; i++)
+	{
+		slot = next_rand() % SHORT_SLOTS;
+		if(short_live[slot] != NULL)
+		{
+			uFree(short_live[slot]);
+			short_live[slot] = NULL;
+		}
+		else
+		{
+			short_live[slot] = uMallocHint(16 + next_rand() % 2000, LIFETIME_SHORT);
+		}
+
+		//
+		// A cada 100 operacoes mexe em um longo, que raramente morre:
+		//
+		if(i % 100) continue;
+		slot = next_rand() % LONG_SLOTS;
+		if(long_live[slot] == NULL)
+		{
+			long_live[slot] = uMallocHint(16 + next_rand() % 200, hint);
+		}
+		else if(next_rand() % 4 == 0)
+		{
+			uFree(long_live[slot]);
+			long_live[slot] = NULL;
+		}
+	}
+
+	for(slot = 0; slot < SHORT_SLOTS; slot++) uFree(short_live[slot]);
+	for(slot = 0; slot < LONG_SLOTS; slot++) longs += (long_live[slot] != NULL);
+
+	printf("%-10s longs=%u largest_free=%u\n", name, longs, uGetLargestFree());
+
+	for(slot = 0; slot < LONG_SLOTS; slot++) uFree(long_live[slot]);
+}
+
+int main(void)
+{
+	HeapInit(heap, HEAP_SIZE);
+
+	replay("short", LIFETIME_SHORT);
+	replay("long", LIFETIME_LONG);
+	return 0;
+}
@@ -0,0 +1,128 @@
+//
+// @file preload_bench.c
+// @brief Carga padrao para o preload_bench.sh: malloc/free com
+//        tamanhos misturados sobre um conjunto vivo, mede a latencia
+//        de cada operacao e o pico de RSS do processo.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#define LIVE_SLOTS							(16384)
+#define MAX_OPS									(4 * 1024 * 1024)
+#define LARGE_ROUNDS						(16)
+
+//
+// Amostras estaticas para nao passar pelo alocador medido:
+//
+static uint32_t samples[MAX_OPS];
+static void *live[LIVE_SLOTS];
+
+//
+// next_rand(), xorshift para a carga ser igual nos dois alocadores
+//
+static uint32_t rnd = 2463534242u;
+static uint32_t next_rand(void)
+{
+	rnd ^= rnd << 13;
+	rnd ^= rnd >> 17;
+	rnd ^= rnd << 5;
+	return rnd;
+}
+
+//
+// next_size(): maioria pequena, alguns medios, raros grandes
+//
+static size_t next_size(void)
+{
+	uint32_t r = next_rand() % 1000;
+
+	if(r < 800) return 16 + next_rand() % 496;
+	if(r < 995) return 512 + next_rand() % 65024;
+	return 256 * 1024 + next_rand() % (768 * 1024);
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+	return (x > y) - (x < y);
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t ops = (argc > 1) ? strtoul(argv[1], NULL, 0) : 1000000;
+	uint32_t i, slot, large_failed = 0;
+	uint64_t t0;
+	size_t size;
+	struct rusage ru;
+
+	if(ops > MAX_OPS) ops = MAX_OPS;
+
+	//
+	// Blocos grandes, de 32MB a 256MB, um de cada vez e com o heap
+	// ainda no tamanho inicial: exercita o crescimento do heap quando
+	// o arredondamento de classe passa de 1MB. Toca o inicio e o fim
+	// de cada bloco:
+	//
+	for(i = 0; i < LARGE_ROUNDS; i++)
+	{
+		size = (32u << 20) + (size_t) (next_rand() % 225) * (1u << 20) + next_rand() % 4096;
+		live[0] = malloc(size);
+		if(live[0] == NULL)
+		{
+			large_failed++;
+			continue;
+		}
+		memset(live[0], (int) i, 64);
+		memset((uint8_t *) live[0] + size - 64, (int) i, 64);
+		free(live[0]);
+	}
+	live[0] = NULL;
+
+	for(i = 0; i < ops; i++)
+	{
+		slot = next_rand() % LIVE_SLOTS;
+
+		//
+		// Slot ocupado libera, slot vazio aloca e toca a memoria:
+		//
+		if(live[slot] != NULL)
+		{
+			t0 = now_ns();
+			free(live[slot]);
+			samples[i] = now_ns() - t0;
+			live[slot] = NULL;
+		}
+		else
+		{
+			size = next_size();
+			t0 = now_ns();
+			live[slot] = malloc(size);
+			samples[i] = now_ns() - t0;
+			if(live[slot] != NULL) memset(live[slot], (int) i, size < 64 ? size : 64);
+		}
+	}
+
+	for(slot = 0; slot < LIVE_SLOTS; slot++) free(live[slot]);
+
+
+	getrusage(RUSAGE_SELF, &ru);
+	qsort(samples, ops, sizeof(samples[0]), cmp_u32);
+
+	printf("ops=%u p50=%uns p99=%uns p99.9=%uns max=%uns maxrss=%ldkB large_failed=%u/%u\n",
+		   ops, samples[ops / 2], samples[(uint64_t) ops * 99 / 100],
+		   samples[(uint64_t) ops * 999 / 1000], samples[ops - 1], ru.ru_maxrss,
+		   large_failed, LARGE_ROUNDS);
+	return large_failed ? 1 : 0;
+}
@@ -0,0 +1,32 @@
+#!/bin/sh
+#
+# preload_bench.sh - compila o shim de LD_PRELOAD (libtlsf_preload.so)
+# e roda a mesma carga com o malloc do glibc e com o TLSF.
+#
+# uso: ./preload_bench.sh [ops] [comando ...]
+#      sem comando roda o preload_bench; com comando, roda o comando
+#      nos dois alocadores e mostra tempo e pico de RSS.
+#
+set -e
+
+cd "$(dirname "$0")"
+CC=${CC:-cc}
+OPS=${1:-1000000}
+[ $# -gt 0 ] && shift
+
+$CC -O2 -fPIC -shared -fvisibility=hidden -fno-builtin -DUSE_MMAP=1 \
+	tlsf.c bits.c tlsf_preload.c -lpthread -o libtlsf_preload.so
+$CC -O2 preload_bench.c -o preload_bench
+
+SHIM="$(pwd)/libtlsf_preload.so"
+
+if [ $# -eq 0 ]; then
+	printf 'glibc: '; ./preload_bench "$OPS"
+	printf 'tlsf:  '; LD_PRELOAD="$SHIM" ./preload_bench "$OPS"
+elif [ -x /usr/bin/time ]; then
+	echo "glibc:"; /usr/bin/time -f "%e s %M kB" "$@" > /dev/null
+	echo "tlsf:";  LD_PRELOAD="$SHIM" /usr/bin/time -f "%e s %M kB" "$@" > /dev/null
+else
+	echo "/usr/bin/time not found" >&2
+	exit 1
+fi
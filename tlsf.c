@@ -67,6 +67,22 @@
  #include <stdio.h>
  #include <string.h>
  #include "tlsf.h"
+
+//
+// Provedor de areas: USE_MMAP habilita o get_new_area() em hosts
+// com mmap, TLSF_USE_HUGEPAGES faz as areas usarem huge pages:
+//
+#ifndef USE_MMAP
+#define USE_MMAP								(0)
+#endif
+
+#ifndef TLSF_USE_HUGEPAGES
+#define TLSF_USE_HUGEPAGES			(0)
+#endif
+
+#if USE_MMAP
+#include <sys/mman.h>
+#endif
  
 //
 // Macros usadas para implementacado do sistema de estatistica:
@@ -97,9 +113,10 @@
 #define MIN_BLOCK_SIZE					(sizeof (free_ptr_t))
 #define BHDR_OVERHEAD						(sizeof (bhdr_t) - MIN_BLOCK_SIZE)
 #define TLSF_SIGNATURE					(0x2A59FA59)
+#define MAX_BLOCK_SIZE					((size_t) 1 << MAX_FLI)     //Primeiro tamanho fora do first level index
 
 #define	PTR_MASK								(sizeof(void *) - 1)
-#define BLOCK_SIZE							(0xFFFFFFFF - PTR_MASK)
+#define BLOCK_SIZE							(0xFFFFFFFF & ~(PTR_MASK | ZERO_STATE))
 
 #define GET_NEXT_BLOCK(_addr, _r) ((bhdr_t *) ((uint8_t *) (_addr) + (_r)))
 #define	MEM_ALIGN		  					((BLOCK_ALIGN) - 1)
@@ -117,11 +134,34 @@
 #define PREV_FREE								(0x2)
 #define PREV_USED								(0x0)
 
+//
+// Bloco que nunca foi entregue desde que a area foi zerada,
+// usado pelo calloc para pular o memset:
+//
+#define ZERO_STATE							(0x4)
+#define ZERO_BLOCK							(0x4)
+#define DIRTY_BLOCK							(0x0)
+
 //
 // Area size se utilizado com SBRK:
 //
 #define DEFAULT_AREA_SIZE (1024*10)
 
+//
+// Granularidade das areas obtidas via mmap:
+//
+#define PAGE_SIZE_BYTES					(4096)
+#define HUGE_PAGE_SIZE					(2 * 1024 * 1024)
+
+//
+// Tipo de area retornado pelo get_new_area(): com MADV_HUGEPAGE o
+// kernel pode nao usar huge pages (THP em never, falta de memoria
+// contigua), entao essas areas sao contadas separadamente:
+//
+#define AREA_NORMAL							(0)
+#define AREA_HUGETLB						(1)
+#define AREA_THP_ADVISED				(2)
+
 
 //
 // Log & asserts:
@@ -153,6 +193,14 @@ typedef struct bhdr_struct
 		
 }bhdr_t;
 
+//
+// No da fila de frees adiados, guardado no payload do bloco:
+//
+typedef struct defer_node_struct 
+{
+    struct defer_node_struct *next;
+} defer_node_t;
+
 //
 // Area info:
 //
@@ -170,9 +218,24 @@ typedef struct TLSF_struct
 	uint32_t tlsf_signature;
 	size_t used_size;
 	size_t max_size;
+	size_t huge_size;
+	size_t advised_size;
 
 	area_info_t *area_head;
 
+	//
+	// Posicao do compactador incremental na cadeia fisica:
+	//
+	bhdr_t *compact_cursor;
+
+	//
+	// Lock da pool e fila (MPSC) de frees adiados pelo uTryFree:
+	//
+	uint8_t lock;
+	defer_node_t *defer_head;
+	defer_node_t *defer_tail;
+	defer_node_t defer_stub;
+
 	//
 	// Bitmap de acesso aos blocos:
 	//
@@ -189,6 +252,35 @@ typedef struct TLSF_struct
 //
 // mecanismo de Thread safe 
 //
+// Com TLSF_USE_LOCKS a pool e protegida por um spinlock de um byte,
+// as macros podem ser redefinidas para usar o mutex do RTOS desde
+// que TLSF_TRY_LOCK nunca bloqueie. Sem TLSF_USE_LOCKS nao ha como
+// saber se a pool esta no meio de uma operacao, entao o uTryMalloc
+// e o uTryFree nunca tocam a pool diretamente:
+//
+#ifndef TLSF_USE_LOCKS
+#define TLSF_USE_LOCKS					(0)
+#endif
+
+#ifndef TLSF_TRY_LOCK
+#if TLSF_USE_LOCKS
+#define TLSF_TRY_LOCK(_l)				(!__atomic_test_and_set((_l), __ATOMIC_ACQUIRE))
+#define TLSF_RELEASE_LOCK(_l)		__atomic_clear((_l), __ATOMIC_RELEASE)
+#else
+#define TLSF_TRY_LOCK(_l)				(1)
+#define TLSF_RELEASE_LOCK(_l)
+#endif
+#endif
+
+#ifndef TLSF_ACQUIRE_LOCK
+#define TLSF_ACQUIRE_LOCK(_l)		do { } while (!TLSF_TRY_LOCK(_l))
+#endif
+
+//
+// Maximo de frees adiados processados por aquisicao do lock, mantem
+// o custo de cada operacao limitado:
+//
+#define TLSF_DRAIN_MAX					(4)
 
 
 //
@@ -206,16 +298,33 @@ static size_t init_memory_pool(size_t mem_pool_size, void *mem_pool);
 static size_t add_new_area(void *area, size_t area_size, void *mem_pool);
 static size_t get_used_size(void *mem_pool);
 static size_t get_max_size(void *mem_pool);
+static size_t get_huge_size(void *mem_pool);
+static size_t get_advised_size(void *mem_pool);
 static void destroy_memory_pool(void *mem_pool);
+static void reset_memory_pool(void *mem_pool);
 static void *malloc_ex(size_t size, void *mem_pool);	
 static void free_ex(void *ptr, void *mem_pool);
+static void *memalign_ex(size_t align, size_t size, void *mem_pool);
+static void *calloc_ex(size_t nelem, size_t elem_size, void *mem_pool);
+static void *malloc_hint_ex(size_t size, int32_t hint, void *mem_pool);
+static size_t get_largest_free(void *mem_pool);
+static __inline int32_t is_handle_block(handle_table_t *table, bhdr_t *b);
+static __inline bhdr_t *slide_block(tlsf_t *tlsf, bhdr_t *f, bhdr_t *u);
+static size_t compact_ex(handle_table_t *table, size_t budget, void *mem_pool);
+static __inline void init_defer_queue(tlsf_t *tlsf);
+static __inline void defer_push(tlsf_t *tlsf, defer_node_t *n);
+static __inline defer_node_t *defer_pop(tlsf_t *tlsf);
+static __inline void drain_deferred(tlsf_t *tlsf);
+static __inline void pool_lock(void *mem_pool);
+static __inline void pool_unlock(void *mem_pool);
+static size_t usable_size_ex(void *ptr);
 //
 // ls_bit()
 //
 static __inline int32_t ls_bit(int32_t i)
 {
 	//Usa a funcao otimizada contida em bitman.c:
-	return(fls(i));
+	return(ufls(i));
 }
 
 //
@@ -224,7 +333,7 @@ static __inline int32_t ls_bit(int32_t i)
 static __inline int32_t ms_bit(int32_t i)
 {
 	//usa funcao otimizada contida em bitman.c
-	return(ffs(i));
+	return(uffs(i));
 }
 
 //
@@ -380,8 +489,64 @@ static __inline bhdr_t *FIND_SUITABLE_BLOCK(tlsf_t * _tlsf, int32_t *_fl, int32_
 //
 // get_new_area()
 //	
-static __inline void *get_new_area(size_t * size) 
+static __inline void *get_new_area(size_t * size, int32_t *huge) 
 {
+#if USE_MMAP
+    void *area;
+#if TLSF_USE_HUGEPAGES
+    uint8_t *raw, *aligned;
+    size_t raw_size;
+#endif
+
+    *huge = AREA_NORMAL;
+
+#if TLSF_USE_HUGEPAGES
+		//
+		// Areas com huge pages tem tamanho multiplo de 2MiB, assim
+		// nenhuma pagina da area fica parcialmente usada:
+		//
+    *size = ROUNDUP(*size, HUGE_PAGE_SIZE);
+
+#ifdef MAP_HUGETLB
+    area = mmap(0, *size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (area != MAP_FAILED) 
+		{
+        *huge = AREA_HUGETLB;
+        return area;
+    }
+#endif
+
+		//
+		// Sem pool de hugetlbfs: pega uma area alinhada em 2MiB
+		// e pede ao kernel para usar transparent huge pages:
+		//
+    raw_size = *size + HUGE_PAGE_SIZE;
+    raw = mmap(0, raw_size, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw != MAP_FAILED) 
+		{
+        aligned = (uint8_t *) ROUNDUP((unsigned long) raw, HUGE_PAGE_SIZE);
+        if (aligned != raw)
+            munmap(raw, aligned - raw);
+        if (raw + raw_size != aligned + *size)
+            munmap(aligned + *size, (raw + raw_size) - (aligned + *size));
+#ifdef MADV_HUGEPAGE
+        if (!madvise(aligned, *size, MADV_HUGEPAGE))
+            *huge = AREA_THP_ADVISED;
+#endif
+        return aligned;
+    }
+#else
+    *size = ROUNDUP(*size, PAGE_SIZE_BYTES);
+    area = mmap(0, *size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (area != MAP_FAILED)
+        return area;
+#endif
+#else
+    *huge = AREA_NORMAL;
+#endif
     return ((void *) ~0);
 }
 
@@ -480,6 +645,11 @@ size_t init_memory_pool(size_t mem_pool_size, void *mem_pool)
 		//
     tlsf->used_size = mem_pool_size - (b->size & BLOCK_SIZE);
     tlsf->max_size = tlsf->used_size;
+    tlsf->huge_size = 0;
+    tlsf->advised_size = 0;
+    tlsf->compact_cursor = NULL;
+    tlsf->lock = 0;
+    init_defer_queue(tlsf);
 
 
     return (b->size & BLOCK_SIZE);
@@ -493,6 +663,7 @@ size_t add_new_area(void *area, size_t area_size, void *mem_pool)
     tlsf_t *tlsf = (tlsf_t *) mem_pool;
     area_info_t *ptr, *ptr_prev, *ai;
     bhdr_t *ib0, *b0, *lb0, *ib1, *b1, *lb1, *next_b;
+    int32_t merged = 0;
 
     memset(area, 0, area_size);
     ptr = tlsf->area_head;
@@ -527,6 +698,7 @@ size_t add_new_area(void *area, size_t area_size, void *mem_pool)
 
             b1->prev_hdr = b0;
             lb0 = lb1;
+            merged = 1;
 
             continue;
         }
@@ -551,6 +723,7 @@ size_t add_new_area(void *area, size_t area_size, void *mem_pool)
             next_b->prev_hdr = lb1;
             b0 = lb1;
             ib0 = ib1;
+            merged = 1;
 
             continue;
         }
@@ -563,6 +736,18 @@ size_t add_new_area(void *area, size_t area_size, void *mem_pool)
     ai->end = lb0;
     tlsf->area_head = ai;
     free_ex(b0->ptr.buffer, mem_pool);
+
+		//
+		// Area recem zerada e sem fusao com headers antigos: o bloco
+		// inteiro pode ser entregue ao calloc sem memset:
+		//
+    if (!merged)
+        b0->size |= ZERO_BLOCK;
+
+		//
+		// A fusao pode ter engolido o header onde estava o compactador:
+		//
+    tlsf->compact_cursor = NULL;
 		
 		
     return (b0->size & BLOCK_SIZE);
@@ -591,6 +776,54 @@ size_t get_max_size(void *mem_pool)
 	 return ((tlsf_t *) mem_pool)->max_size;
 }
 
+//
+// get_huge_size()
+//
+size_t get_huge_size(void *mem_pool)
+{
+	 //
+	 // bytes da pool que estao em areas MAP_HUGETLB:
+	 //
+	 return ((tlsf_t *) mem_pool)->huge_size;
+}
+
+//
+// get_advised_size()
+//
+size_t get_advised_size(void *mem_pool)
+{
+	 //
+	 // bytes da pool em areas com MADV_HUGEPAGE, que podem ou nao
+	 // estar de fato em huge pages (ver AnonHugePages no smaps):
+	 //
+	 return ((tlsf_t *) mem_pool)->advised_size;
+}
+
+//
+// get_largest_free()
+//
+size_t get_largest_free(void *mem_pool)
+{
+	 //
+	 // O maior bloco livre esta na maior buddy list nao vazia, mas nao
+	 // necessariamente na cabeca dela, entao percorre so essa lista:
+	 //
+	 tlsf_t *tlsf = (tlsf_t *) mem_pool;
+	 bhdr_t *b;
+	 size_t largest = 0;
+	 int32_t fl, sl;
+
+	 if (!tlsf->fl_bitmap) return 0;
+	 fl = ms_bit(tlsf->fl_bitmap);
+	 sl = ms_bit(tlsf->sl_bitmap[fl]);
+	 for (b = tlsf->matrix[fl][sl]; b != NULL; b = b->ptr.free_ptr.next)
+	 {
+		 if ((b->size & BLOCK_SIZE) > largest)
+			 largest = b->size & BLOCK_SIZE;
+	 }
+	 return largest;
+}
+
 //
 // destroy_memory_pool()
 //
@@ -604,6 +837,70 @@ void destroy_memory_pool(void *mem_pool)
     tlsf->tlsf_signature = 0;
 }
 
+//
+// reset_memory_pool()
+//
+void reset_memory_pool(void *mem_pool)
+{
+		//
+		// Descarta todos os blocos alocados da pool sem percorrer
+		// os blocos, cada area da lista volta a ser um unico bloco livre:
+		//
+    tlsf_t *tlsf = (tlsf_t *) mem_pool;
+    area_info_t *ai;
+    bhdr_t *ib, *b, *lb;
+    defer_node_t *n, *next, *head;
+    int32_t fl, sl;
+
+		//
+		// Produtores do defer_push que ja fizeram o exchange ainda vao
+		// escrever no next do no anterior, que e um bloco da pool. Espera
+		// a fila assentar ate a cabeca vista aqui antes de reciclar:
+		//
+    head = __atomic_load_n(&tlsf->defer_head, __ATOMIC_ACQUIRE);
+    for (n = tlsf->defer_tail; n != head; n = next)
+        while (!(next = __atomic_load_n(&n->next, __ATOMIC_ACQUIRE)));
+
+		//
+		// Limpa os bitmaps e as cabecas da buddy list:
+		//
+    tlsf->fl_bitmap = 0;
+    memset(tlsf->sl_bitmap, 0, sizeof(tlsf->sl_bitmap));
+    memset(tlsf->matrix, 0, sizeof(tlsf->matrix));
+
+    for (ai = tlsf->area_head; ai; ai = ai->next) 
+		{
+        ib = (bhdr_t *) ((uint8_t *) ai - BHDR_OVERHEAD);
+        b = GET_NEXT_BLOCK(ib->ptr.buffer, ib->size & BLOCK_SIZE);
+        lb = ai->end;
+
+				//
+				// O bloco livre vai do fim do header da area ate o sentinela:
+				//
+        b->size = ((uint8_t *) lb - b->ptr.buffer) | FREE_BLOCK | PREV_USED;
+        lb->prev_hdr = b;
+        lb->size = 0 | USED_BLOCK | PREV_FREE;
+
+        MAPPING_INSERT(b->size & BLOCK_SIZE, &fl, &sl);
+        INSERT_BLOCK(b, tlsf, fl, sl);
+    }
+
+		//
+		// Zera o sistema de estatistica da pool:
+		//
+    tlsf->used_size = 0;
+    tlsf->max_size = 0;
+    tlsf->compact_cursor = NULL;
+
+		//
+		// Frees adiados apontam para blocos que nao existem mais e sao
+		// descartados. Um uTryFree que comece depois da espera acima
+		// corre com o reset, por isso o chamador nao deve liberar a
+		// pool enquanto a recicla:
+		//
+    init_defer_queue(tlsf);
+}
+
 //
 // malloc_ex()
 //
@@ -618,10 +915,14 @@ void *malloc_ex(size_t size, void *mem_pool)
     size_t tmp_size;
 
 		//checagem e round de tamanho:
+    if (size >= MAX_BLOCK_SIZE) return NULL;
     size = (size < MIN_BLOCK_SIZE) ? MIN_BLOCK_SIZE : ROUNDUP_SIZE(size);
 
 		//Busca os bit positions:
     MAPPING_SEARCH(&size, &fl, &sl);
+
+		//o arredondamento pode passar da ultima classe
+    if (fl >= REAL_FLI) return NULL;
 	
 		//Busca o bloco usando o good fit strategy
     b = FIND_SUITABLE_BLOCK(tlsf, &fl, &sl);
@@ -643,11 +944,11 @@ void *malloc_ex(size_t size, void *mem_pool)
 			  //
         tmp_size -= BHDR_OVERHEAD;
         b2 = GET_NEXT_BLOCK(b->ptr.buffer, size);
-        b2->size = tmp_size | FREE_BLOCK | PREV_USED;
+        b2->size = tmp_size | FREE_BLOCK | PREV_USED | (b->size & ZERO_STATE);
         next_b->prev_hdr = b2;
         MAPPING_INSERT(tmp_size, &fl, &sl);
         INSERT_BLOCK(b2, tlsf, fl, sl);
-        b->size = size | (b->size & PREV_STATE);
+        b->size = size | (b->size & (PREV_STATE | ZERO_STATE));
     } 
 		else 
 		{
@@ -664,13 +965,93 @@ void *malloc_ex(size_t size, void *mem_pool)
     return (void *) b->ptr.buffer;
 }
 
+//
+// malloc_hint_ex()
+//
+void *malloc_hint_ex(size_t size, int32_t hint, void *mem_pool)
+{
+		//
+		// Blocos de vida curta seguem o malloc_ex normal e saem do
+		// inicio do bloco livre. Os de vida longa, qualquer dica que nao
+		// seja LIFETIME_SHORT, saem do fim do maior bloco livre, assim
+		// as duas populacoes crescem em sentidos opostos. Sair do fim do
+		// bloco do good fit nao basta: a frente livre volta para a mesma
+		// classe e o proximo bloco curto cai logo ao lado do longo:
+		//
+    tlsf_t *tlsf = (tlsf_t *) mem_pool;
+    bhdr_t *b = NULL, *b2, *next_b;
+    int32_t fl, sl, top_fl, top_sl;
+    size_t tmp_size;
+
+    if (hint == LIFETIME_SHORT) return malloc_ex(size, mem_pool);
+
+		//checagem e round de tamanho:
+    if (size >= MAX_BLOCK_SIZE) return NULL;
+    size = (size < MIN_BLOCK_SIZE) ? MIN_BLOCK_SIZE : ROUNDUP_SIZE(size);
+    MAPPING_SEARCH(&size, &fl, &sl);
+    if (fl >= REAL_FLI) return NULL;
+
+		//longo: tenta a cabeca da maior buddy list
+    if (tlsf->fl_bitmap) 
+		{
+        top_fl = ms_bit(tlsf->fl_bitmap);
+        top_sl = ms_bit(tlsf->sl_bitmap[top_fl]);
+        b = tlsf->matrix[top_fl][top_sl];
+        if ((b->size & BLOCK_SIZE) >= size) 
+				{
+            fl = top_fl;
+            sl = top_sl;
+        } 
+				else 
+				{
+            b = NULL;
+        }
+    }
+
+		//senao usa o good fit
+    if (b == NULL) b = FIND_SUITABLE_BLOCK(tlsf, &fl, &sl);
+    if (b == NULL) return NULL;
+
+    EXTRACT_BLOCK_HDR(b, tlsf, fl, sl);
+
+    next_b = GET_NEXT_BLOCK(b->ptr.buffer, b->size & BLOCK_SIZE);
+    tmp_size = (b->size & BLOCK_SIZE) - size;
+
+		if (tmp_size >= sizeof(bhdr_t)) 
+		{
+				//
+				// split pelo fim: a frente continua livre e o
+				// bloco entregue fica encostado no proximo
+			  //
+        tmp_size -= BHDR_OVERHEAD;
+        b2 = GET_NEXT_BLOCK(b->ptr.buffer, tmp_size);
+        b2->size = size | USED_BLOCK | PREV_FREE | (b->size & ZERO_STATE);
+        b2->prev_hdr = b;
+        next_b->prev_hdr = b2;
+        next_b->size &= (~PREV_FREE);
+        b->size = tmp_size | FREE_BLOCK | (b->size & (PREV_STATE | ZERO_STATE));
+        MAPPING_INSERT(tmp_size, &fl, &sl);
+        INSERT_BLOCK(b, tlsf, fl, sl);
+        b = b2;
+    } 
+		else 
+		{
+        next_b->size &= (~PREV_FREE);
+        b->size &= (~FREE_BLOCK);       
+    }
+
+    TLSF_ADD_SIZE(tlsf, b);
+
+    return (void *) b->ptr.buffer;
+}
+
 //
 // free_ex()
 //
 void free_ex(void *ptr, void *mem_pool)
 {
     tlsf_t *tlsf = (tlsf_t *) mem_pool;
-    bhdr_t *b, *tmp_b;
+    bhdr_t *b, *tmp_b, *absorbed = NULL;
     int32_t fl = 0, sl = 0;
 
 		//bloco invalido? nao realiza acao
@@ -678,7 +1059,8 @@ void free_ex(void *ptr, void *mem_pool)
 	
 	
     b = (bhdr_t *) ((uint8_t *) ptr - BHDR_OVERHEAD);
-    b->size |= FREE_BLOCK;
+    if (tlsf->compact_cursor == b) absorbed = b;
+    b->size = (b->size | FREE_BLOCK) & ~ZERO_STATE;
     TLSF_REMOVE_SIZE(tlsf, b);
 
     b->ptr.free_ptr.prev = NULL;
@@ -699,6 +1081,7 @@ void free_ex(void *ptr, void *mem_pool)
         MAPPING_INSERT(tmp_b->size & BLOCK_SIZE, &fl, &sl);
         EXTRACT_BLOCK(tmp_b, tlsf, fl, sl);
         b->size += (tmp_b->size & BLOCK_SIZE) + BHDR_OVERHEAD;
+        if (tlsf->compact_cursor == tmp_b) absorbed = tmp_b;
     }
     if (b->size & PREV_FREE) 
 		{
@@ -706,6 +1089,7 @@ void free_ex(void *ptr, void *mem_pool)
         MAPPING_INSERT(tmp_b->size & BLOCK_SIZE, &fl, &sl);
         EXTRACT_BLOCK(tmp_b, tlsf, fl, sl);
         tmp_b->size += (b->size & BLOCK_SIZE) + BHDR_OVERHEAD;
+        tmp_b->size &= ~ZERO_STATE;
         b = tmp_b;
     }
 		
@@ -715,6 +1099,11 @@ void free_ex(void *ptr, void *mem_pool)
     MAPPING_INSERT(b->size & BLOCK_SIZE, &fl, &sl);
     INSERT_BLOCK(b, tlsf, fl, sl);
 
+		//
+		// O compactador nunca pode ficar apontando para um header fundido:
+		//
+    if (absorbed) tlsf->compact_cursor = b;
+
 		//
 		// atualiza buddylist para proxima posicao livre nesse bloco
 		//
@@ -724,85 +1113,922 @@ void free_ex(void *ptr, void *mem_pool)
 }
 
 //
-//Funcoes publicas:
-// 
- 
-//
-// HeapInit()
+// memalign_ex()
 //
-void HeapInit(uint8_t *heapp, uint32_t heapSize)
+void *memalign_ex(size_t align, size_t size, void *mem_pool)
 {
-	int32_t size = 0;
+    bhdr_t *b, *b2;
+    uint8_t *ptr, *aligned;
+    size_t gap;
+
+		//alinhamento natural do bloco ja atende?
+    if (align <= BLOCK_ALIGN) return malloc_ex(size, mem_pool);
 
-	//
-	// checa se o heap eh valido:
-	//
-	if(heapp == 0)
-	{
 		//
-		// Mata o sistema de lock e nao inicializa
+		// Pede folga para o alinhamento mais um header inteiro, assim
+		// a parte da frente sempre pode virar um bloco livre:
 		//
-		return;
-	}
-	
-	//
-	// Pede ao alocator pra preparar o heap:
-	//
-	size = init_memory_pool(heapSize, heapp);
-	
-	if(size == 0)
-	{
-		return;
-	}
-	
-	//Inicializou corretamente, heap pronto para uso.
+    if (size >= MAX_BLOCK_SIZE || align >= MAX_BLOCK_SIZE) return NULL;
+    size = (size < MIN_BLOCK_SIZE) ? MIN_BLOCK_SIZE : ROUNDUP_SIZE(size);
+    ptr = (uint8_t *) malloc_ex(size + align + sizeof(bhdr_t), mem_pool);
+    if (!ptr) return NULL;
+    if (!((unsigned long) ptr & (align - 1))) return ptr;
+
+		//
+		// O gap vira tamanho de bloco, entao nao pode tocar nos bits de
+		// estado. Com ponteiro de 64 bits o ZERO_STATE cabe no PTR_MASK e
+		// um gap multiplo do ponteiro basta; com 32 bits o gap precisa ser
+		// multiplo de BLOCK_ALIGN, o que exige a pool alinhada nele:
+		//
+    if (PTR_MASK < ZERO_STATE && ((unsigned long) ptr & MEM_ALIGN)) 
+		{
+        free_ex(ptr, mem_pool);
+        return NULL;
+    }
+
+    aligned = (uint8_t *) ROUNDUP((unsigned long) ptr + sizeof(bhdr_t), align);
+    gap = aligned - ptr;
+
+		//
+		// Quebra o bloco em dois: o alinhado fica com o resto do
+		// tamanho e o da frente e devolvido a pool pelo free_ex:
+		//
+    b = (bhdr_t *) (ptr - BHDR_OVERHEAD);
+    b2 = (bhdr_t *) (aligned - BHDR_OVERHEAD);
+    b2->size = ((b->size & BLOCK_SIZE) - gap) | USED_BLOCK | PREV_USED | (b->size & ZERO_STATE);
+    b2->prev_hdr = b;
+    GET_NEXT_BLOCK(b2->ptr.buffer, b2->size & BLOCK_SIZE)->prev_hdr = b2;
+    b->size = (gap - BHDR_OVERHEAD) | USED_BLOCK | (b->size & PREV_STATE);
+    free_ex(b->ptr.buffer, mem_pool);
+
+    return (void *) aligned;
 }
 
+//
+// calloc_ex()
+//
+void *calloc_ex(size_t nelem, size_t elem_size, void *mem_pool)
+{
+    bhdr_t *b;
+    void *ptr;
+    size_t size;
+
+		//checagem de overflow do produto:
+    if (elem_size && nelem > ((size_t) -1) / elem_size) return NULL;
+    size = nelem * elem_size;
+
+    ptr = malloc_ex(size, mem_pool);
+    if (!ptr) return NULL;
+
+		//
+		// So limpa o bloco se ele ja foi usado desde que a area
+		// foi zerada pelo add_new_area:
+		//
+    b = (bhdr_t *) ((uint8_t *) ptr - BHDR_OVERHEAD);
+    if (!(b->size & ZERO_STATE))
+        memset(ptr, 0, size);
+
+    return ptr;
+}
 
 //
-//	uMalloc()
+// usable_size_ex()
 //
+size_t usable_size_ex(void *ptr)
+{
+		//
+		// O tamanho real do bloco inclui a sobra do arredondamento
+		// do MAPPING_SEARCH e de um split nao realizado:
+		//
+    bhdr_t *b;
 
-void *uMalloc(uint32_t size)
+    if (!ptr) return 0;
+    b = (bhdr_t *) ((uint8_t *) ptr - BHDR_OVERHEAD);
+    return (b->size & BLOCK_SIZE);
+}
+
+//
+// is_handle_block()
+//
+static __inline int32_t is_handle_block(handle_table_t *table, bhdr_t *b)
 {
-	void *p = NULL;
-	
-	//
-	// Limita o size do bloco:
-	//
-	if(size > 16384) size = 16000;
-	
-	//
-	// Acessa o alocador em safe mode 
-	//
-	p = malloc_ex(size, mp);
-	
-	return(p);
+		//
+		// Blocos de handle guardam o indice no inicio do payload, e
+		// a entrada da tabela aponta de volta para o header:
+		//
+    uint32_t h = *(uint32_t *) b->ptr.buffer;
+
+    return (h < table->count && table->entries[h].block == (void *) b);
 }
 
 //
-// uFree()
-//        
-void uFree(void *p)
+// slide_block()
+//
+static __inline bhdr_t *slide_block(tlsf_t *tlsf, bhdr_t *f, bhdr_t *u)
 {
-	//
-	// checa consistencia do bloco:
-	//
-	if(p == NULL) return;
-	free_ex(p, mp);
+		//
+		// Troca de lugar o bloco livre f com o bloco usado u logo
+		// depois dele: u passa a comecar no header de f e o espaco
+		// livre vai para depois de u, onde pode fundir com o proximo:
+		//
+    size_t f_size = f->size & BLOCK_SIZE, u_size = u->size & BLOCK_SIZE;
+    bhdr_t *nu, *nf, *next_b;
+    int32_t fl, sl;
+
+    MAPPING_INSERT(f_size, &fl, &sl);
+    EXTRACT_BLOCK(f, tlsf, fl, sl);
+    next_b = GET_NEXT_BLOCK(u->ptr.buffer, u_size);
+
+    nu = f;
+    memmove(nu->ptr.buffer, u->ptr.buffer, u_size);
+    nu->size = u_size | USED_BLOCK | (f->size & PREV_STATE);
+
+    nf = GET_NEXT_BLOCK(nu->ptr.buffer, u_size);
+    nf->prev_hdr = nu;
+    nf->size = f_size | FREE_BLOCK | PREV_USED;
+    nf->ptr.free_ptr.prev = NULL;
+    nf->ptr.free_ptr.next = NULL;
+
+    if (next_b->size & FREE_BLOCK) 
+		{
+        MAPPING_INSERT(next_b->size & BLOCK_SIZE, &fl, &sl);
+        EXTRACT_BLOCK(next_b, tlsf, fl, sl);
+        nf->size += (next_b->size & BLOCK_SIZE) + BHDR_OVERHEAD;
+        next_b = GET_NEXT_BLOCK(nf->ptr.buffer, nf->size & BLOCK_SIZE);
+    }
+    next_b->prev_hdr = nf;
+    next_b->size |= PREV_FREE;
+
+    MAPPING_INSERT(nf->size & BLOCK_SIZE, &fl, &sl);
+    INSERT_BLOCK(nf, tlsf, fl, sl);
+
+    return nu;
 }
 
 //
-// uGetAvailable()
+// compact_ex()
 //
-uint32_t uGetAvailable(void)
+size_t compact_ex(handle_table_t *table, size_t budget, void *mem_pool)
 {
-	if(mp != NULL)
-	{
-		return(get_max_size(mp) - get_used_size(mp));
-	}
-	else
- 	{
-		return 0;
-	}		
+		//
+		// Passo do compactador incremental: percorre a cadeia fisica a
+		// partir do cursor e desliza blocos de handle nao fixados sobre
+		// o bloco livre anterior, ate gastar budget bytes de trabalho.
+		// Ao fim de uma passada completa o cursor volta ao inicio.
+		//
+		// Cada header visitado custa BHDR_OVERHEAD e cada bloco movido
+		// custa o seu tamanho, e nenhum memmove passa do que resta do
+		// budget. Pior caso por chamada: budget bytes copiados, mais
+		// budget / BHDR_OVERHEAD headers visitados, mais uma busca na
+		// lista de areas a cada sentinela cruzada:
+		//
+    tlsf_t *tlsf = (tlsf_t *) mem_pool;
+    area_info_t *ai;
+    bhdr_t *b, *next_b;
+    size_t spent = 0, moved = 0, u_size;
+    uint32_t h;
+
+    b = tlsf->compact_cursor;
+
+    while (spent < budget) 
+		{
+        if (b == NULL) 
+				{
+            if (!tlsf->area_head) break;
+            b = (bhdr_t *) ((uint8_t *) tlsf->area_head - BHDR_OVERHEAD);
+        }
+
+				//
+				// Sentinela do fim da area: segue para a proxima area
+				//
+        if (!(b->size & BLOCK_SIZE)) 
+				{
+            for (ai = tlsf->area_head; ai && ai->end != b; ai = ai->next);
+            ai = ai ? ai->next : NULL;
+            b = ai ? (bhdr_t *) ((uint8_t *) ai - BHDR_OVERHEAD) : NULL;
+            if (b == NULL) break;
+            continue;
+        }
+
+        next_b = GET_NEXT_BLOCK(b->ptr.buffer, b->size & BLOCK_SIZE);
+        spent += BHDR_OVERHEAD;
+
+        if ((b->size & FREE_BLOCK) && !(next_b->size & FREE_BLOCK) &&
+            (next_b->size & BLOCK_SIZE) && is_handle_block(table, next_b)) 
+				{
+            h = *(uint32_t *) next_b->ptr.buffer;
+            u_size = next_b->size & BLOCK_SIZE;
+
+						//
+						// Bloco que nao cabe nem num budget inteiro fica no
+						// lugar; se so nao cabe no que sobrou, para aqui e a
+						// proxima chamada comeca por ele:
+						//
+            if (!table->entries[h].pins && u_size + BHDR_OVERHEAD <= budget) 
+						{
+                if (spent + u_size > budget) break;
+
+                b = slide_block(tlsf, b, next_b);
+                table->entries[h].block = (void *) b;
+                spent += b->size & BLOCK_SIZE;
+                moved += b->size & BLOCK_SIZE;
+                continue;
+            }
+        }
+        b = next_b;
+    }
+
+    tlsf->compact_cursor = b;
+    return moved;
+}
+
+//
+// init_defer_queue()
+//
+static __inline void init_defer_queue(tlsf_t *tlsf)
+{
+    tlsf->defer_stub.next = NULL;
+    tlsf->defer_head = &tlsf->defer_stub;
+    tlsf->defer_tail = &tlsf->defer_stub;
+}
+
+//
+// defer_push()
+//
+static __inline void defer_push(tlsf_t *tlsf, defer_node_t *n)
+{
+		//
+		// Produtor wait-free: um exchange e um store, sem retry,
+		// pode ser chamado de qualquer contexto inclusive signal:
+		//
+    defer_node_t *prev;
+
+    n->next = NULL;
+    prev = __atomic_exchange_n(&tlsf->defer_head, n, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&prev->next, n, __ATOMIC_RELEASE);
+}
+
+//
+// defer_pop()
+//
+static __inline defer_node_t *defer_pop(tlsf_t *tlsf)
+{
+		//
+		// Consumidor unico, sempre com o lock da pool tomado. Um
+		// produtor no meio do push faz o pop retornar NULL, o no
+		// fica para a proxima aquisicao:
+		//
+    defer_node_t *tail = tlsf->defer_tail;
+    defer_node_t *next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+
+    if (tail == &tlsf->defer_stub) 
+		{
+        if (!next) return NULL;
+        tlsf->defer_tail = next;
+        tail = next;
+        next = __atomic_load_n(&next->next, __ATOMIC_ACQUIRE);
+    }
+    if (next) 
+		{
+        tlsf->defer_tail = next;
+        return tail;
+    }
+    if (tail != __atomic_load_n(&tlsf->defer_head, __ATOMIC_ACQUIRE)) return NULL;
+
+    defer_push(tlsf, &tlsf->defer_stub);
+    next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    if (next) 
+		{
+        tlsf->defer_tail = next;
+        return tail;
+    }
+    return NULL;
+}
+
+//
+// drain_deferred()
+//
+static __inline void drain_deferred(tlsf_t *tlsf)
+{
+    defer_node_t *n;
+    int32_t i;
+
+    for (i = 0; i < TLSF_DRAIN_MAX; i++) 
+		{
+        n = defer_pop(tlsf);
+        if (!n) break;
+        free_ex(n, tlsf);
+    }
+}
+
+//
+// pool_lock()
+//
+static __inline void pool_lock(void *mem_pool)
+{
+    tlsf_t *tlsf = (tlsf_t *) mem_pool;
+
+    TLSF_ACQUIRE_LOCK(&tlsf->lock);
+    drain_deferred(tlsf);
+}
+
+//
+// pool_unlock()
+//
+static __inline void pool_unlock(void *mem_pool)
+{
+    TLSF_RELEASE_LOCK(&((tlsf_t *) mem_pool)->lock);
+}
+
+//
+//Funcoes publicas:
+// 
+ 
+//
+// HeapInit()
+//
+void HeapInit(uint8_t *heapp, uint32_t heapSize)
+{
+	int32_t size = 0;
+
+	//
+	// checa se o heap eh valido:
+	//
+	if(heapp == 0)
+	{
+		//
+		// Mata o sistema de lock e nao inicializa
+		//
+		return;
+	}
+	
+	//
+	// Pede ao alocator pra preparar o heap:
+	//
+	size = init_memory_pool(heapSize, heapp);
+	
+	if(size == 0)
+	{
+		return;
+	}
+	
+	//Inicializou corretamente, heap pronto para uso.
+}
+
+
+//
+//	uMalloc()
+//
+
+void *uMalloc(uint32_t size)
+{
+	void *p = NULL;
+	
+	//
+	// Limita o size do bloco:
+	//
+	if(size > 16384) size = 16000;
+	
+	//
+	// Acessa o alocador em safe mode 
+	//
+	pool_lock(mp);
+	p = malloc_ex(size, mp);
+	pool_unlock(mp);
+	
+	return(p);
+}
+
+//
+//	uMallocAtLeast()
+//
+
+void *uMallocAtLeast(uint32_t size, uint32_t *usable)
+{
+	void *p = NULL;
+	
+	//
+	// Aloca sem limitar o size e informa quanto o bloco
+	// entregue realmente comporta:
+	//
+	pool_lock(mp);
+	p = malloc_ex(size, mp);
+	pool_unlock(mp);
+	
+	if(usable != NULL) *usable = usable_size_ex(p);
+	
+	return(p);
+}
+
+//
+//	uMallocHint()
+//
+
+void *uMallocHint(uint32_t size, int32_t hint)
+{
+	void *p;
+	
+	pool_lock(mp);
+	p = malloc_hint_ex(size, hint, mp);
+	pool_unlock(mp);
+	
+	return(p);
+}
+
+//
+// uCalloc()
+//
+void *uCalloc(uint32_t nelem, uint32_t elemSize)
+{
+	void *p;
+	
+	pool_lock(mp);
+	p = calloc_ex(nelem, elemSize, mp);
+	pool_unlock(mp);
+	
+	return(p);
+}
+
+//
+// uMallocAligned()
+//
+void *uMallocAligned(uint32_t align, uint32_t size)
+{
+	//
+	// alinhamento deve ser potencia de 2:
+	//
+	void *p;
+	
+	if(align == 0 || (align & (align - 1))) return NULL;
+	
+	pool_lock(mp);
+	p = memalign_ex(align, size, mp);
+	pool_unlock(mp);
+	
+	return(p);
+}
+
+//
+// uBudgetInit()
+//
+void uBudgetInit(budget_t *budget, uint32_t softLimit, uint32_t hardLimit)
+{
+	if(budget == NULL) return;
+	
+	memset(budget, 0, sizeof(budget_t));
+	budget->soft_limit = softLimit;
+	budget->hard_limit = hardLimit;
+}
+
+//
+// uBudgetMalloc()
+//
+void *uBudgetMalloc(budget_t *budget, uint32_t size)
+{
+	uint8_t *p = NULL;
+	uint32_t charge;
+	
+	//size + BLOCK_ALIGN nao pode dar a volta:
+	if(budget == NULL || size >= MAX_BLOCK_SIZE) return NULL;
+	
+	//
+	// O custo do bloco e contado como no TLSF_ADD_SIZE, tamanho
+	// do bloco mais o header. Checa o limite rigido antes de
+	// tocar a pool:
+	//
+	pool_lock(mp);
+	
+	charge = ROUNDUP_SIZE(size) + BLOCK_ALIGN + BHDR_OVERHEAD;
+	if(budget->hard_limit && budget->used + charge > budget->hard_limit)
+	{
+		budget->denied++;
+		pool_unlock(mp);
+		return NULL;
+	}
+	
+	//
+	// O orcamento fica gravado no inicio do payload, como o indice
+	// do uHandleAlloc, e o free devolve o custo a ele:
+	//
+	p = (uint8_t *) malloc_ex(size + BLOCK_ALIGN, mp);
+	
+	//
+	// O arredondamento do MAPPING_SEARCH pode ter estourado o limite:
+	//
+	if(p != NULL)
+	{
+		charge = usable_size_ex(p) + BHDR_OVERHEAD;
+		if(budget->hard_limit && budget->used + charge > budget->hard_limit)
+		{
+			free_ex(p, mp);
+			budget->denied++;
+			p = NULL;
+		}
+		else
+		{
+			*(budget_t **) p = budget;
+			p += BLOCK_ALIGN;
+			budget->used += charge;
+			if(budget->used > budget->peak) budget->peak = budget->used;
+			if(budget->soft_limit && budget->used > budget->soft_limit) budget->soft_hits++;
+		}
+	}
+	
+	pool_unlock(mp);
+	return((void *) p);
+}
+
+//
+// uBudgetFree()
+//
+void uBudgetFree(budget_t *budget, void *p)
+{
+	budget_t *owner;
+	uint8_t *b;
+	uint32_t charge;
+	
+	if(p == NULL) return;
+	
+	//
+	// O custo volta ao orcamento gravado no bloco, mesmo que o
+	// chamador passe o de outro tenant:
+	//
+	b = (uint8_t *) p - BLOCK_ALIGN;
+	owner = *(budget_t **) b;
+	if(owner == NULL) owner = budget;
+	
+	pool_lock(mp);
+	charge = usable_size_ex(b) + BHDR_OVERHEAD;
+	if(owner != NULL)
+	{
+		owner->used -= (charge < owner->used) ? charge : owner->used;
+	}
+	free_ex(b, mp);
+	pool_unlock(mp);
+}
+
+//
+// uHandleInit()
+//
+void uHandleInit(handle_table_t *table, handle_t *entries, uint32_t count)
+{
+	uint32_t i;
+	
+	table->entries = entries;
+	table->count = count;
+	table->free_head = HANDLE_INVALID;
+	
+	//
+	// Todas as entradas comecam na lista de livres:
+	//
+	for(i = count; i > 0; i--)
+	{
+		entries[i - 1].block = NULL;
+		entries[i - 1].pins = 0;
+		entries[i - 1].next = table->free_head;
+		table->free_head = i - 1;
+	}
+}
+
+//
+// uHandleAlloc()
+//
+uint32_t uHandleAlloc(handle_table_t *table, uint32_t size)
+{
+	uint32_t h;
+	uint8_t *p;
+	
+	//size + BLOCK_ALIGN nao pode dar a volta:
+	if(size >= MAX_BLOCK_SIZE) return(HANDLE_INVALID);
+	
+	pool_lock(mp);
+	
+	h = table->free_head;
+	if(h != HANDLE_INVALID)
+	{
+		//
+		// O indice do handle fica no inicio do payload, antes dos
+		// dados do usuario, para o compactador achar a entrada:
+		//
+		p = (uint8_t *) malloc_ex(size + BLOCK_ALIGN, mp);
+		if(p != NULL)
+		{
+			*(uint32_t *) p = h;
+			table->free_head = table->entries[h].next;
+			table->entries[h].block = (void *) (p - BHDR_OVERHEAD);
+			table->entries[h].pins = 0;
+		}
+		else
+		{
+			h = HANDLE_INVALID;
+		}
+	}
+	
+	pool_unlock(mp);
+	return(h);
+}
+
+//
+// uHandleFree()
+//
+void uHandleFree(handle_table_t *table, uint32_t h)
+{
+	bhdr_t *b;
+	
+	if(h >= table->count) return;
+	
+	pool_lock(mp);
+	
+	b = (bhdr_t *) table->entries[h].block;
+	if(b != NULL)
+	{
+		table->entries[h].block = NULL;
+		table->entries[h].next = table->free_head;
+		table->free_head = h;
+		free_ex(b->ptr.buffer, mp);
+	}
+	
+	pool_unlock(mp);
+}
+
+//
+// uHandlePin()
+//
+void *uHandlePin(handle_table_t *table, uint32_t h)
+{
+	bhdr_t *b;
+	void *p = NULL;
+	
+	if(h >= table->count) return NULL;
+	
+	//
+	// Enquanto fixado o bloco nao e movido pelo compactador:
+	//
+	pool_lock(mp);
+	b = (bhdr_t *) table->entries[h].block;
+	if(b != NULL)
+	{
+		table->entries[h].pins++;
+		p = b->ptr.buffer + BLOCK_ALIGN;
+	}
+	pool_unlock(mp);
+	
+	return(p);
+}
+
+//
+// uHandleUnpin()
+//
+void uHandleUnpin(handle_table_t *table, uint32_t h)
+{
+	if(h >= table->count) return;
+	
+	pool_lock(mp);
+	if(table->entries[h].pins) table->entries[h].pins--;
+	pool_unlock(mp);
+}
+
+//
+// uHeapCompact()
+//
+uint32_t uHeapCompact(handle_table_t *table, uint32_t budget)
+{
+	uint32_t moved;
+	
+	if(mp == NULL) return 0;
+	
+	pool_lock(mp);
+	moved = compact_ex(table, budget, mp);
+	pool_unlock(mp);
+	
+	return(moved);
+}
+
+//
+// uReserveInit()
+//
+void uReserveInit(reserve_t *reserve, uint8_t *mem, uint32_t blockSize, uint32_t count)
+{
+	if(count > 32) count = 32;
+	
+	reserve->base = mem;
+	reserve->block_size = blockSize;
+	reserve->count = count;
+	reserve->free_mask = (count == 32) ? 0xFFFFFFFF : ((1UL << count) - 1);
+}
+
+//
+// uTryMalloc()
+//
+void *uTryMalloc(reserve_t *reserve, uint32_t size)
+{
+	tlsf_t *tlsf = (tlsf_t *) mp;
+	void *p = NULL;
+	uint32_t mask;
+	int32_t i;
+	
+	//
+	// Nunca espera pelo lock: se a pool estiver livre usa o
+	// malloc_ex normal, o drain e limitado a TLSF_DRAIN_MAX:
+	//
+	if(TLSF_USE_LOCKS && tlsf != NULL && TLSF_TRY_LOCK(&tlsf->lock))
+	{
+		drain_deferred(tlsf);
+		p = malloc_ex(size, tlsf);
+		TLSF_RELEASE_LOCK(&tlsf->lock);
+		if(p != NULL) return(p);
+	}
+	
+	//
+	// Pool ocupada ou sem espaco: tenta a reserva do contexto
+	//
+	if(reserve == NULL || size > reserve->block_size) return NULL;
+	
+	mask = __atomic_load_n(&reserve->free_mask, __ATOMIC_ACQUIRE);
+	while(mask)
+	{
+		i = ls_bit(mask);
+		if(__atomic_compare_exchange_n(&reserve->free_mask, &mask, mask & ~(1UL << i),
+									   0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+		{
+			return(reserve->base + i * reserve->block_size);
+		}
+	}
+	
+	return NULL;
+}
+
+//
+// uTryFree()
+//
+void uTryFree(reserve_t *reserve, void *p)
+{
+	tlsf_t *tlsf = (tlsf_t *) mp;
+	uint32_t i;
+	
+	if(p == NULL) return;
+	
+	//
+	// Blocos da reserva voltam para a reserva, mesmo sem pool:
+	//
+	if(reserve != NULL && (uint8_t *) p >= reserve->base &&
+	   (uint8_t *) p < reserve->base + reserve->count * reserve->block_size)
+	{
+		i = ((uint8_t *) p - reserve->base) / reserve->block_size;
+		__atomic_fetch_or(&reserve->free_mask, 1UL << i, __ATOMIC_RELEASE);
+		return;
+	}
+	
+	if(tlsf == NULL) return;
+	
+	//
+	// Pool livre libera na hora, senao o bloco entra na fila
+	// wait-free e sera liberado por quem tomar o lock:
+	//
+	if(TLSF_USE_LOCKS && TLSF_TRY_LOCK(&tlsf->lock))
+	{
+		free_ex(p, tlsf);
+		drain_deferred(tlsf);
+		TLSF_RELEASE_LOCK(&tlsf->lock);
+	}
+	else
+	{
+		defer_push(tlsf, (defer_node_t *) p);
+	}
+}
+
+//
+// uUsableSize()
+//
+uint32_t uUsableSize(void *p)
+{
+	return(usable_size_ex(p));
+}
+
+//
+// uFree()
+//        
+void uFree(void *p)
+{
+	//
+	// checa consistencia do bloco:
+	//
+	if(p == NULL) return;
+	
+	pool_lock(mp);
+	free_ex(p, mp);
+	pool_unlock(mp);
+}
+
+//
+// uHeapReset()
+//
+void uHeapReset(void)
+{
+	//
+	// Recicla a pool default inteira em tempo constante:
+	//
+	if(mp == NULL) return;
+	
+	pool_lock(mp);
+	reset_memory_pool(mp);
+	pool_unlock(mp);
+}
+
+//
+// uHeapGrow()
+//
+uint32_t uHeapGrow(uint32_t size)
+{
+	size_t area_size;
+	int32_t huge = AREA_NORMAL, fl, sl;
+	void *area;
+	
+	if(mp == NULL || size >= MAX_BLOCK_SIZE) return 0;
+	
+	//
+	// O malloc_ex arredonda o pedido para a proxima classe antes de
+	// buscar, entao a area precisa comportar o tamanho ja arredondado,
+	// alem dos headers da area:
+	//
+	area_size = (size < MIN_BLOCK_SIZE) ? MIN_BLOCK_SIZE : ROUNDUP_SIZE(size);
+	MAPPING_SEARCH(&area_size, &fl, &sl);
+	if(fl >= REAL_FLI) return 0;
+	area_size += sizeof(area_info_t) + 4 * BHDR_OVERHEAD;
+	if(area_size < DEFAULT_AREA_SIZE) area_size = DEFAULT_AREA_SIZE;
+	
+	area = get_new_area(&area_size, &huge);
+	if(area == ((void *) ~0)) return 0;
+	
+	pool_lock(mp);
+	size = add_new_area(area, area_size, mp);
+	if(huge == AREA_HUGETLB) ((tlsf_t *) mp)->huge_size += area_size;
+	if(huge == AREA_THP_ADVISED) ((tlsf_t *) mp)->advised_size += area_size;
+	pool_unlock(mp);
+	
+	return(size);
+}
+
+//
+// uGetHugeSize()
+//
+uint32_t uGetHugeSize(void)
+{
+	uint32_t size;
+	
+	if(mp == NULL) return 0;
+	
+	pool_lock(mp);
+	size = get_huge_size(mp);
+	pool_unlock(mp);
+	return(size);
+}
+
+//
+// uGetAdvisedSize()
+//
+uint32_t uGetAdvisedSize(void)
+{
+	uint32_t size;
+	
+	if(mp == NULL) return 0;
+	
+	pool_lock(mp);
+	size = get_advised_size(mp);
+	pool_unlock(mp);
+	return(size);
+}
+
+//
+// uGetLargestFree()
+//
+uint32_t uGetLargestFree(void)
+{
+	uint32_t size;
+	
+	if(mp == NULL) return 0;
+	
+	//
+	// Percorre a buddy list, que um free concorrente pode alterar:
+	//
+	pool_lock(mp);
+	size = get_largest_free(mp);
+	pool_unlock(mp);
+	return(size);
+}
+
+//
+// uGetAvailable()
+//
+uint32_t uGetAvailable(void)
+{
+	uint32_t size = 0;
+	
+	if(mp != NULL)
+	{
+		pool_lock(mp);
+		size = get_max_size(mp) - get_used_size(mp);
+		pool_unlock(mp);
+	}
+	return(size);
 }
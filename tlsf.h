@@ -11,18 +11,71 @@
 
 
 
-// @fn ffs()
+// @fn uffs()
 // @brief retorna o numero do bit onde aparece o 
-//        set mais significativo
+//        set mais significativo, -1 para word nulo
 uint32_t uffs(uint32_t word);
 
 
 //
-// @fn fls()
+// @fn ufls()
 // @brief retorna o numero do bit onde aparece o 
-//        set menos significativo
+//        set menos significativo (contagem de zeros a
+//        direita), -1 para word nulo. Vale para todos os
+//        targets, ARM inclusive
 uint32_t ufls(uint32_t word);
 
+//
+// Dicas de tempo de vida para o uMallocHint():
+//
+#define LIFETIME_SHORT					(0)
+#define LIFETIME_LONG						(1)
+
+//
+// Orcamento de memoria de um tenant, usado pelo uBudgetMalloc()
+// e uBudgetFree(). Limites em zero significam sem limite.
+//
+typedef struct budget_struct
+{
+	uint32_t used;
+	uint32_t peak;
+	uint32_t soft_limit;
+	uint32_t hard_limit;
+	uint32_t soft_hits;
+	uint32_t denied;
+} budget_t;
+
+//
+// Handles para alocacoes moveis, ver uHandleAlloc():
+//
+#define HANDLE_INVALID					(0xFFFFFFFF)
+
+typedef struct handle_struct
+{
+	void *block;
+	uint32_t pins;
+	uint32_t next;
+} handle_t;
+
+typedef struct handle_table_struct
+{
+	handle_t *entries;
+	uint32_t count;
+	uint32_t free_head;
+} handle_table_t;
+
+//
+// Reserva de emergencia de um contexto (thread de tempo real,
+// signal handler) para o uTryMalloc(), ate 32 blocos fixos:
+//
+typedef struct reserve_struct
+{
+	uint8_t *base;
+	uint32_t block_size;
+	uint32_t count;
+	uint32_t free_mask;
+} reserve_t;
+
 //
 // @fn HeapInit()
 // @brief Inicializa um Heap para usar como pool de memoria
@@ -36,12 +89,157 @@ void HeapInit(uint8_t *heapp,uint32_t heapSize);
 
 void *uMalloc(uint32_t size);
 
+//
+// @fn uMallocAtLeast()
+// @brief Aloca ao menos size bytes e retorna em usable
+//        o tamanho que o bloco realmente comporta
+void *uMallocAtLeast(uint32_t size, uint32_t *usable);
+
+//
+// @fn uMallocHint()
+// @brief Aloca um bloco segregando pelo tempo de vida em duas
+//        classes: LIFETIME_LONG sai do fim do maior bloco livre,
+//        longe dos LIFETIME_SHORT, que seguem o uMalloc. Blocos que
+//        nunca morrem tambem usam LIFETIME_LONG
+void *uMallocHint(uint32_t size, int32_t hint);
+
+//
+// @fn uCalloc()
+// @brief Aloca nelem * elemSize bytes zerados, pulando o
+//        memset quando o bloco vem de area ainda nao usada
+void *uCalloc(uint32_t nelem, uint32_t elemSize);
+
+//
+// @fn uMallocAligned()
+// @brief Aloca size bytes alinhados em align (potencia de 2)
+void *uMallocAligned(uint32_t align, uint32_t size);
+
+//
+// @fn uBudgetInit()
+// @brief Prepara o orcamento de um tenant, acima do softLimit
+//        as alocacoes sao contadas em soft_hits, acima do
+//        hardLimit sao negadas
+void uBudgetInit(budget_t *budget, uint32_t softLimit, uint32_t hardLimit);
+
+//
+// @fn uBudgetMalloc()
+// @brief Aloca um bloco debitando do orcamento do tenant. O
+//        orcamento fica gravado no bloco, que so pode ser
+//        liberado com uBudgetFree()
+void *uBudgetMalloc(budget_t *budget, uint32_t size);
+
+//
+// @fn uBudgetFree()
+// @brief Libera um bloco alocado com uBudgetMalloc() e devolve
+//        o custo ao orcamento gravado nele
+void uBudgetFree(budget_t *budget, void *p);
+
+//
+// @fn uHandleInit()
+// @brief Prepara uma tabela com count handles para alocacoes
+//        moveis
+void uHandleInit(handle_table_t *table, handle_t *entries, uint32_t count);
+
+//
+// @fn uHandleAlloc()
+// @brief Aloca um bloco movel e retorna seu handle, ou
+//        HANDLE_INVALID
+uint32_t uHandleAlloc(handle_table_t *table, uint32_t size);
+
+//
+// @fn uHandleFree()
+// @brief Libera o bloco e o handle
+void uHandleFree(handle_table_t *table, uint32_t h);
+
+//
+// @fn uHandlePin()
+// @brief Fixa o bloco e retorna seu endereco atual, valido ate
+//        o uHandleUnpin() correspondente
+void *uHandlePin(handle_table_t *table, uint32_t h);
+
+//
+// @fn uHandleUnpin()
+// @brief Libera o bloco para ser movido pelo compactador
+void uHandleUnpin(handle_table_t *table, uint32_t h);
+
+//
+// @fn uHeapCompact()
+// @brief Executa uma fatia do compactador, movendo blocos de
+//        handle nao fixados sobre o espaco livre anterior ate
+//        gastar budget bytes de trabalho. Nunca copia mais que
+//        budget bytes por chamada; blocos maiores que o budget
+//        ficam no lugar. Retorna os bytes movidos
+uint32_t uHeapCompact(handle_table_t *table, uint32_t budget);
+
+//
+// @fn uReserveInit()
+// @brief Prepara uma reserva com count (max 32) blocos de
+//        blockSize bytes em mem
+void uReserveInit(reserve_t *reserve, uint8_t *mem, uint32_t blockSize, uint32_t count);
+
+//
+// @fn uTryMalloc()
+// @brief Aloca sem nunca esperar pelo lock da pool, usando a
+//        reserva se a pool estiver ocupada. Pode retornar NULL.
+//        Sem TLSF_USE_LOCKS so a reserva e usada, pois a pool
+//        pode estar no meio do uMalloc interrompido
+void *uTryMalloc(reserve_t *reserve, uint32_t size);
+
+//
+// @fn uTryFree()
+// @brief Libera sem esperar pelo lock, adiando o free se a pool
+//        estiver ocupada. Aceita blocos da pool ou da reserva.
+//        Sem TLSF_USE_LOCKS todo bloco da pool e adiado ate a
+//        proxima chamada normal da API
+void uTryFree(reserve_t *reserve, void *p);
+
+//
+// @fn uUsableSize()
+// @brief Tamanho utilizavel de um bloco alocado
+uint32_t uUsableSize(void *p);
+
 //
 // @fn uFree()
 // @brief Destroi um bloco de memoria previamente
 //        Alocado
 void uFree(void *p);
 
+//
+// @fn uHeapReset()
+// @brief Libera todos os blocos do heap de uma vez, em
+//        tempo constante, sem reinicializar as areas. Frees
+//        adiados pelo uTryFree sao descartados; nao chamar
+//        uTryFree de outro contexto durante o reset
+void uHeapReset(void);
+
+
+//
+// @fn uHeapGrow()
+// @brief Obtem uma nova area do sistema (USE_MMAP) com espaco
+//        para ao menos size bytes e a adiciona ao heap; um
+//        uMalloc de size logo em seguida sempre e atendido
+uint32_t uHeapGrow(uint32_t size);
+
+
+//
+// @fn uGetHugeSize()
+// @brief Bytes do heap que estao em areas MAP_HUGETLB
+uint32_t uGetHugeSize(void);
+
+
+//
+// @fn uGetAdvisedSize()
+// @brief Bytes do heap em areas com MADV_HUGEPAGE, o uso real
+//        de huge pages depende do THP do kernel
+uint32_t uGetAdvisedSize(void);
+
+
+//
+// @fn uGetLargestFree()
+// @brief Tamanho do maior bloco livre, para medir fragmentacao.
+//        Percorre so a maior buddy list nao vazia
+uint32_t uGetLargestFree(void);
+
 
 //
 // @fn uGetAvailable()
@@ -0,0 +1,381 @@
+//
+// @file tlsf_ofs.c
+// @brief Alocador de offsets baseado no TLSF: mesmo indice de dois
+//        niveis (fl_bitmap / sl_bitmap) do tlsf.c, mas os blocos sao
+//        descritos por nos em um pool separado, nada e escrito
+//        dentro do range gerenciado.
+//
+#include <stdio.h>
+#include <string.h>
+#include "tlsf.h"
+#include "tlsf_ofs.h"
+
+#define SMALL_BLOCK							(128)
+
+//
+// Log & asserts:
+//
+#define ERROR_MSG(fmt, args...) printf(fmt, ## args)
+
+//
+// Forward references de funcoes internas:
+//
+static __inline void set_bit(int32_t nr, uint32_t * addr);
+static __inline void clear_bit(int32_t nr, uint32_t * addr);
+static __inline int32_t ls_bit(int32_t x);
+static __inline int32_t ms_bit(int32_t x);
+static __inline void MAPPING_SEARCH(uint32_t * _r, int32_t *_fl, int32_t *_sl);
+static __inline void MAPPING_INSERT(uint32_t _r, int32_t *_fl, int32_t *_sl);
+static __inline uint32_t FIND_SUITABLE_NODE(ofs_pool_t * _p, int32_t *_fl, int32_t *_sl);
+static __inline void insert_node(ofs_pool_t *p, uint32_t n);
+static __inline void extract_node(ofs_pool_t *p, uint32_t n);
+static __inline uint32_t get_spare_node(ofs_pool_t *p);
+static __inline void put_spare_node(ofs_pool_t *p, uint32_t n);
+
+//
+// ls_bit()
+//
+static __inline int32_t ls_bit(int32_t i)
+{
+	return(ufls(i));
+}
+
+//
+// ms_bit():
+//
+static __inline int32_t ms_bit(int32_t i)
+{
+	return(uffs(i));
+}
+
+//
+// set_bit()
+//
+static __inline void set_bit(int32_t nr, uint32_t * addr)
+{
+    addr[nr >> 5] |= 1U << (nr & 0x1f);
+}
+
+//
+// clear bit:
+//
+static __inline void clear_bit(int32_t nr, uint32_t * addr)
+{
+    addr[nr >> 5] &= ~(1U << (nr & 0x1f));
+}
+
+//
+// MAPPING_SEARCH()
+//
+static __inline void MAPPING_SEARCH(uint32_t * _r, int32_t *_fl, int32_t *_sl)
+{
+    int32_t _t;
+
+		//
+		// Ao contrario do tlsf.c, aqui os tamanhos nao sao multiplos da
+		// largura das classes pequenas, entao arredonda para a proxima
+		// classe como o caminho grande faz:
+		//
+    if (*_r < SMALL_BLOCK)
+        *_r = (*_r + (SMALL_BLOCK / OFS_MAX_SLI) - 1) & ~((SMALL_BLOCK / OFS_MAX_SLI) - 1);
+
+    if (*_r < SMALL_BLOCK)
+		{
+        *_fl = 0;
+        *_sl = *_r / (SMALL_BLOCK / OFS_MAX_SLI);
+    }
+		else
+		{
+        _t = (1 << (ms_bit(*_r) - OFS_MAX_LOG2_SLI)) - 1;
+        *_r = *_r + _t;
+        *_fl = ms_bit(*_r);
+        *_sl = (*_r >> (*_fl - OFS_MAX_LOG2_SLI)) - OFS_MAX_SLI;
+        *_fl -= OFS_FLI_OFFSET;
+        *_r &= ~_t;
+    }
+}
+
+//
+// MAPPING_INSERT:
+//
+static __inline void MAPPING_INSERT(uint32_t _r, int32_t *_fl, int32_t *_sl)
+{
+    if (_r < SMALL_BLOCK)
+		{
+        *_fl = 0;
+        *_sl = _r / (SMALL_BLOCK / OFS_MAX_SLI);
+    }
+		else
+		{
+        *_fl = ms_bit(_r);
+        *_sl = (_r >> (*_fl - OFS_MAX_LOG2_SLI)) - OFS_MAX_SLI;
+        *_fl -= OFS_FLI_OFFSET;
+    }
+}
+
+//
+// FIND_SUITABLE_NODE()
+//
+static __inline uint32_t FIND_SUITABLE_NODE(ofs_pool_t * _p, int32_t *_fl, int32_t *_sl)
+{
+    uint32_t _tmp = _p->sl_bitmap[*_fl] & (~0U << *_sl);
+    uint32_t _n = OFS_INVALID;
+
+		//
+		// Mesma estrategia good fit do tlsf.c, trocando ponteiros
+		// de header por indices de no:
+		//
+    if (_tmp)
+		{
+        *_sl = ls_bit(_tmp);
+        _n = _p->matrix[*_fl][*_sl];
+    }
+		else
+		{
+        *_fl = ls_bit(_p->fl_bitmap & (~0U << (*_fl + 1)));
+
+				if (*_fl > 0)
+				{
+            *_sl = ls_bit(_p->sl_bitmap[*_fl]);
+            _n = _p->matrix[*_fl][*_sl];
+        }
+    }
+    return _n;
+}
+
+//
+// insert_node()
+//
+static __inline void insert_node(ofs_pool_t *p, uint32_t n)
+{
+    ofs_node_t *node = &p->nodes[n];
+    int32_t fl, sl;
+
+    MAPPING_INSERT(node->size, &fl, &sl);
+    node->prev_free = OFS_INVALID;
+    node->next_free = p->matrix[fl][sl];
+    if (node->next_free != OFS_INVALID)
+        p->nodes[node->next_free].prev_free = n;
+    p->matrix[fl][sl] = n;
+    set_bit(sl, &p->sl_bitmap[fl]);
+    set_bit(fl, &p->fl_bitmap);
+}
+
+//
+// extract_node()
+//
+static __inline void extract_node(ofs_pool_t *p, uint32_t n)
+{
+    ofs_node_t *node = &p->nodes[n];
+    int32_t fl, sl;
+
+    MAPPING_INSERT(node->size, &fl, &sl);
+    if (node->next_free != OFS_INVALID)
+        p->nodes[node->next_free].prev_free = node->prev_free;
+    if (node->prev_free != OFS_INVALID)
+        p->nodes[node->prev_free].next_free = node->next_free;
+    if (p->matrix[fl][sl] == n)
+		{
+        p->matrix[fl][sl] = node->next_free;
+        if (p->matrix[fl][sl] == OFS_INVALID)
+				{
+            clear_bit(sl, &p->sl_bitmap[fl]);
+            if (!p->sl_bitmap[fl])
+                clear_bit(fl, &p->fl_bitmap);
+        }
+    }
+    node->prev_free = OFS_INVALID;
+    node->next_free = OFS_INVALID;
+}
+
+//
+// get_spare_node()
+//
+static __inline uint32_t get_spare_node(ofs_pool_t *p)
+{
+    uint32_t n = p->spare_head;
+
+    if (n != OFS_INVALID)
+        p->spare_head = p->nodes[n].next_free;
+    return n;
+}
+
+//
+// put_spare_node()
+//
+static __inline void put_spare_node(ofs_pool_t *p, uint32_t n)
+{
+    p->nodes[n].used = 0;
+    p->nodes[n].size = 0;
+    p->nodes[n].next_free = p->spare_head;
+    p->spare_head = n;
+}
+
+//
+// uOfsInit()
+//
+uint32_t uOfsInit(ofs_pool_t *pool, ofs_node_t *nodes, uint32_t nodeCount,
+                  uint32_t rangeSize, uint32_t align)
+{
+    uint32_t i, n;
+
+		//
+		// Checa consistencia dos parametros:
+		//
+    if (!pool || !nodes || !nodeCount || !align || (align & (align - 1)))
+	{
+        ERROR_MSG("uOfsInit (): invalid parameters\n");
+        return 0;
+    }
+
+		//
+		// O range fica limitado ao maior first level indexavel:
+		//
+    if (rangeSize >= (1UL << OFS_MAX_FLI))
+        rangeSize = (1UL << OFS_MAX_FLI) - 1;
+    rangeSize &= ~(align - 1);
+    if (!rangeSize)
+	{
+        ERROR_MSG("uOfsInit (): range smaller than alignment\n");
+        return 0;
+    }
+
+    memset(pool, 0, sizeof(ofs_pool_t));
+    memset(pool->matrix, 0xFF, sizeof(pool->matrix));
+    pool->nodes = nodes;
+    pool->node_count = nodeCount;
+    pool->align = align;
+
+		//
+		// Todos os nos comecam na pilha de reserva:
+		//
+    pool->spare_head = OFS_INVALID;
+    for (i = nodeCount; i > 0; i--)
+        put_spare_node(pool, i - 1);
+
+		//
+		// O range inteiro vira um unico bloco livre:
+		//
+    n = get_spare_node(pool);
+    nodes[n].offset = 0;
+    nodes[n].size = rangeSize;
+    nodes[n].prev_phys = OFS_INVALID;
+    nodes[n].next_phys = OFS_INVALID;
+    insert_node(pool, n);
+
+    return rangeSize;
+}
+
+//
+// uOfsAlloc()
+//
+uint32_t uOfsAlloc(ofs_pool_t *pool, uint32_t size, uint32_t *offset)
+{
+    ofs_node_t *node, *rem;
+    uint32_t n, r;
+    int32_t fl, sl;
+
+		//checagem e round de tamanho:
+    if (!size || size >= (1UL << OFS_MAX_FLI) - pool->align) return OFS_INVALID;
+    size = (size + pool->align - 1) & ~(pool->align - 1);
+
+		//Busca os bit positions:
+    MAPPING_SEARCH(&size, &fl, &sl);
+    if (fl >= OFS_REAL_FLI) return OFS_INVALID;
+
+		//Busca o no usando o good fit strategy
+    n = FIND_SUITABLE_NODE(pool, &fl, &sl);
+    if (n == OFS_INVALID) return OFS_INVALID;
+
+    extract_node(pool, n);
+    node = &pool->nodes[n];
+
+		//
+		// Sem header em banda qualquer sobra pode virar bloco livre,
+		// desde que ainda exista no de reserva, senao a sobra fica
+		// com a alocacao:
+		//
+    if (node->size > size && (r = get_spare_node(pool)) != OFS_INVALID)
+		{
+        rem = &pool->nodes[r];
+        rem->offset = node->offset + size;
+        rem->size = node->size - size;
+        rem->used = 0;
+        rem->prev_phys = n;
+        rem->next_phys = node->next_phys;
+        if (rem->next_phys != OFS_INVALID)
+            pool->nodes[rem->next_phys].prev_phys = r;
+        node->next_phys = r;
+        node->size = size;
+        insert_node(pool, r);
+    }
+    node->used = 1;
+
+		//
+		// atualiza a estatistica do range
+		//
+    pool->used_size += node->size;
+    if (pool->used_size > pool->max_size)
+        pool->max_size = pool->used_size;
+
+    if (offset) *offset = node->offset;
+    return n;
+}
+
+//
+// uOfsFree()
+//
+void uOfsFree(ofs_pool_t *pool, uint32_t n)
+{
+    ofs_node_t *node, *tmp;
+    uint32_t t;
+
+		//no invalido? nao realiza acao
+    if (n >= pool->node_count || !pool->nodes[n].used) return;
+
+    node = &pool->nodes[n];
+    node->used = 0;
+    pool->used_size -= node->size;
+
+		//
+		// Funde com o vizinho fisico seguinte se estiver livre:
+		//
+    t = node->next_phys;
+    if (t != OFS_INVALID && !pool->nodes[t].used)
+		{
+        tmp = &pool->nodes[t];
+        extract_node(pool, t);
+        node->size += tmp->size;
+        node->next_phys = tmp->next_phys;
+        if (node->next_phys != OFS_INVALID)
+            pool->nodes[node->next_phys].prev_phys = n;
+        put_spare_node(pool, t);
+    }
+
+		//
+		// E com o anterior, que absorve este no:
+		//
+    t = node->prev_phys;
+    if (t != OFS_INVALID && !pool->nodes[t].used)
+		{
+        tmp = &pool->nodes[t];
+        extract_node(pool, t);
+        tmp->size += node->size;
+        tmp->next_phys = node->next_phys;
+        if (tmp->next_phys != OFS_INVALID)
+            pool->nodes[tmp->next_phys].prev_phys = t;
+        put_spare_node(pool, n);
+        n = t;
+    }
+
+    insert_node(pool, n);
+}
+
+//
+// uOfsSize()
+//
+uint32_t uOfsSize(ofs_pool_t *pool, uint32_t n)
+{
+    if (n >= pool->node_count || !pool->nodes[n].used) return 0;
+    return pool->nodes[n].size;
+}
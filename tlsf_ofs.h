@@ -0,0 +1,88 @@
+//
+// @file tlsf_ofs.h
+// @brief Variante do TLSF que aloca offsets dentro de um range
+//        abstrato, com os headers dos blocos fora da memoria
+//        gerenciada (arquivos mapeados, janelas de BAR, RDMA).
+//
+#ifndef __TLSF_OFS_H
+#define __TLSF_OFS_H
+
+#include <stdint.h>
+
+//
+// Mesma geometria de bitmaps do tlsf.c:
+//
+#define OFS_MAX_FLI							(30)
+#define OFS_MAX_LOG2_SLI				(5)
+#define OFS_MAX_SLI							(1 << OFS_MAX_LOG2_SLI)
+#define OFS_FLI_OFFSET					(6)
+#define OFS_REAL_FLI						(OFS_MAX_FLI - OFS_FLI_OFFSET)
+
+//
+// Indice de no invalido / offset invalido:
+//
+#define OFS_INVALID							(0xFFFFFFFF)
+
+//
+// No de bloco, guardado no pool de nos do usuario:
+//
+typedef struct ofs_node_struct
+{
+    uint32_t offset;
+    uint32_t size;
+    uint32_t used;
+    uint32_t prev_phys;
+    uint32_t next_phys;
+    uint32_t prev_free;
+    uint32_t next_free;
+} ofs_node_t;
+
+//
+// Controle do alocador de offsets:
+//
+typedef struct ofs_pool_struct
+{
+    uint32_t fl_bitmap;
+    uint32_t sl_bitmap[OFS_REAL_FLI];
+    uint32_t matrix[OFS_REAL_FLI][OFS_MAX_SLI];
+
+    ofs_node_t *nodes;
+    uint32_t node_count;
+    uint32_t spare_head;
+    uint32_t align;
+
+    uint32_t used_size;
+    uint32_t max_size;
+} ofs_pool_t;
+
+
+//
+// @fn uOfsInit()
+// @brief Prepara o alocador para gerenciar [0, rangeSize) usando
+//        nodeCount nos externos, align deve ser potencia de 2.
+//        Retorna o tamanho gerenciavel ou 0 em caso de erro
+//
+uint32_t uOfsInit(ofs_pool_t *pool, ofs_node_t *nodes, uint32_t nodeCount,
+                  uint32_t rangeSize, uint32_t align);
+
+//
+// @fn uOfsAlloc()
+// @brief Aloca size unidades do range, escreve o offset obtido
+//        e retorna o no que identifica a alocacao (OFS_INVALID
+//        se nao houver espaco)
+//
+uint32_t uOfsAlloc(ofs_pool_t *pool, uint32_t size, uint32_t *offset);
+
+//
+// @fn uOfsFree()
+// @brief Devolve ao range a alocacao identificada pelo no
+//
+void uOfsFree(ofs_pool_t *pool, uint32_t node);
+
+//
+// @fn uOfsSize()
+// @brief Tamanho efetivamente reservado para a alocacao
+//
+uint32_t uOfsSize(ofs_pool_t *pool, uint32_t node);
+
+#endif
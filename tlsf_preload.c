@@ -0,0 +1,249 @@
+//
+// @file tlsf_preload.c
+// @brief Shim de LD_PRELOAD que substitui o malloc da libc pelo
+//        TLSF em qualquer binario, para comparar com o glibc sem
+//        portar codigo para a API uMalloc/uFree.
+//
+//        Build (ver preload_bench.sh):
+//        cc -O2 -fPIC -shared -fvisibility=hidden -fno-builtin
+//           -DUSE_MMAP=1 tlsf.c bits.c tlsf_preload.c -lpthread
+//           -o libtlsf_preload.so
+//
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "tlsf.h"
+
+//
+// Pool inicial e granularidade de crescimento, ambos via mmap:
+//
+#define SHIM_POOL_SIZE					(8 * 1024 * 1024)
+#define SHIM_GROW_SIZE					(4 * 1024 * 1024)
+
+//
+// Areas adjacentes sao fundidas pelo add_new_area, e o first level
+// index so enxerga blocos menores que 1GiB, entao o heap total
+// fica limitado abaixo disso:
+//
+#define SHIM_HEAP_LIMIT					(1000UL * 1024 * 1024)
+#define SHIM_MAX_SIZE						(256UL * 1024 * 1024)
+
+#define SHIM_EXPORT __attribute__((visibility("default")))
+
+static pthread_mutex_t shim_lock = PTHREAD_MUTEX_INITIALIZER;
+static size_t shim_heap_size = 0;
+static pthread_once_t shim_fork_once = PTHREAD_ONCE_INIT;
+
+//
+// Handlers de fork: o pool nunca e copiado no meio de uma operacao
+//
+static void shim_prepare(void)
+{
+	pthread_mutex_lock(&shim_lock);
+}
+
+static void shim_release(void)
+{
+	pthread_mutex_unlock(&shim_lock);
+}
+
+//
+// shim_init(), chamado com o lock tomado:
+//
+static int32_t shim_init(void)
+{
+	void *pool;
+
+	if(shim_heap_size != 0) return 1;
+
+	pool = mmap(0, SHIM_POOL_SIZE, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(pool == MAP_FAILED) return 0;
+
+	HeapInit(pool, SHIM_POOL_SIZE);
+	shim_heap_size = SHIM_POOL_SIZE;
+	return 1;
+}
+
+//
+// shim_fork_handlers(), roda uma unica vez via pthread_once:
+//
+static void shim_fork_handlers(void)
+{
+	pthread_atfork(shim_prepare, shim_release, shim_release);
+}
+
+//
+// shim_register_fork(), chamado fora do lock pois o pthread_atfork
+// pode alocar. Duas threads nunca registram os handlers em dobro,
+// o que faria o prepare travar no proprio lock:
+//
+static void shim_register_fork(void)
+{
+	pthread_once(&shim_fork_once, shim_fork_handlers);
+}
+
+//
+// shim_take(), chamado com o lock tomado:
+//
+static void *shim_take(size_t align, size_t size, int32_t zero)
+{
+	if(zero) return(uCalloc(1, size));
+	return(align ? uMallocAligned(align, size) : uMallocAtLeast(size, NULL));
+}
+
+//
+// shim_alloc()
+//
+static void *shim_alloc(size_t align, size_t size, int32_t zero)
+{
+	void *p = NULL;
+	size_t grow;
+
+	if(size > SHIM_MAX_SIZE)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	pthread_mutex_lock(&shim_lock);
+
+	if(shim_init())
+	{
+		p = shim_take(align, size, zero);
+
+		//
+		// Sem bloco adequado: pega mais uma area do sistema e tenta de
+		// novo. O uHeapGrow arredonda grow para a sua classe, o que pode
+		// custar ate 1/32 a mais, e isso entra na conta do limite:
+		//
+		grow = size + align + SHIM_GROW_SIZE / 8;
+		if(grow < SHIM_GROW_SIZE) grow = SHIM_GROW_SIZE;
+		if(p == NULL && shim_heap_size + grow + grow / 32 <= SHIM_HEAP_LIMIT && uHeapGrow(grow))
+		{
+			shim_heap_size += grow + grow / 32;
+			p = shim_take(align, size, zero);
+		}
+	}
+
+	pthread_mutex_unlock(&shim_lock);
+	shim_register_fork();
+
+	if(p == NULL) errno = ENOMEM;
+	return p;
+}
+
+//
+// Interface da libc:
+//
+SHIM_EXPORT void *malloc(size_t size)
+{
+	return(shim_alloc(0, size, 0));
+}
+
+SHIM_EXPORT void free(void *p)
+{
+	if(p == NULL) return;
+
+	pthread_mutex_lock(&shim_lock);
+	uFree(p);
+	pthread_mutex_unlock(&shim_lock);
+}
+
+SHIM_EXPORT void *calloc(size_t nmemb, size_t size)
+{
+	if(size != 0 && nmemb > ((size_t) -1) / size)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	//
+	// uCalloc so faz memset se o bloco nao vier de area nova:
+	//
+	return(shim_alloc(0, nmemb * size, 1));
+}
+
+SHIM_EXPORT void *realloc(void *old, size_t size)
+{
+	void *p;
+	size_t old_size;
+
+	if(old == NULL) return(shim_alloc(0, size, 0));
+	if(size == 0)
+	{
+		free(old);
+		return NULL;
+	}
+
+	//
+	// A sobra do bloco atual ja comporta o novo tamanho?
+	//
+	old_size = uUsableSize(old);
+	if(size <= old_size) return old;
+
+	p = shim_alloc(0, size, 0);
+	if(p == NULL) return NULL;
+
+	memcpy(p, old, old_size);
+	free(old);
+	return p;
+}
+
+SHIM_EXPORT void *reallocarray(void *old, size_t nmemb, size_t size)
+{
+	if(size != 0 && nmemb > ((size_t) -1) / size)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+	return(realloc(old, nmemb * size));
+}
+
+SHIM_EXPORT int posix_memalign(void **memptr, size_t align, size_t size)
+{
+	void *p;
+
+	if(align < sizeof(void *) || (align & (align - 1))) return EINVAL;
+
+	p = shim_alloc(align, size, 0);
+	if(p == NULL) return ENOMEM;
+
+	*memptr = p;
+	return 0;
+}
+
+SHIM_EXPORT void *aligned_alloc(size_t align, size_t size)
+{
+	if(align == 0 || (align & (align - 1)))
+	{
+		errno = EINVAL;
+		return NULL;
+	}
+	return(shim_alloc(align, size, 0));
+}
+
+SHIM_EXPORT void *memalign(size_t align, size_t size)
+{
+	return(aligned_alloc(align, size));
+}
+
+SHIM_EXPORT void *valloc(size_t size)
+{
+	return(shim_alloc(sysconf(_SC_PAGESIZE), size, 0));
+}
+
+SHIM_EXPORT void *pvalloc(size_t size)
+{
+	size_t page = sysconf(_SC_PAGESIZE);
+
+	return(shim_alloc(page, (size + page - 1) & ~(page - 1), 0));
+}
+
+SHIM_EXPORT size_t malloc_usable_size(void *p)
+{
+	return(uUsableSize(p));
+}
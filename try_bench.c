@@ -0,0 +1,308 @@
+//
+// @file try_bench.c
+// @brief Pior caso do uTryMalloc()/uTryFree(): conta as instrucoes
+//        de usuario de cada chamada (perf_event_open), que nao sofrem
+//        com preempcao, com a fila de frees adiados cheia ate o
+//        TLSF_DRAIN_MAX e nos caminhos com a pool ocupada (reserva e
+//        defer_push), e roda o teste de estresse 3+1 threads. Sem
+//        contador de hardware (ex. VM) cai para tempo em ns.
+//
+//        Inclui o tlsf.c para poder segurar o lock da pool:
+//        cc -O2 -DTLSF_USE_LOCKS=1 try_bench.c bits.c -lpthread
+//           -o try_bench
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "tlsf.c"
+
+#define HEAP_SIZE								(4 * 1024 * 1024)
+#define BENCH_OPS								(100000)
+#define RESERVE_BLOCK						(256)
+#define RESERVE_COUNT						(32)
+#define STRESS_THREADS					(3)
+#define STRESS_OPS							(2000000)
+#define STRESS_SLOTS						(256)
+
+static uint8_t heap[HEAP_SIZE] __attribute__((aligned(16)));
+static uint8_t reserve_mem[RESERVE_BLOCK * RESERVE_COUNT] __attribute__((aligned(16)));
+static reserve_t reserve;
+
+//
+// Amostras estaticas, em instrucoes ou ns:
+//
+static uint32_t samples[BENCH_OPS];
+static void *pending[TLSF_DRAIN_MAX];
+static int counter_fd = -1;
+static uint64_t counter_base = 0;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+//
+// counter_open(): instrucoes retiradas so em modo usuario, o que o
+// kernel faz durante uma preempcao nao entra na conta
+//
+static void counter_open(void)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	counter_fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static uint64_t counter_now(void)
+{
+	uint64_t count;
+
+	if(counter_fd < 0) return now_ns();
+	if(read(counter_fd, &count, sizeof(count)) != sizeof(count)) return 0;
+	return count;
+}
+
+//
+// counter_calibrate(): custo fixo de ler o contador, descontado
+// de cada amostra
+//
+static void counter_calibrate(void)
+{
+	uint64_t c0, d, best = ~0ull;
+	int32_t i;
+
+	for(i = 0; i < 1000; i++)
+	{
+		c0 = counter_now();
+		d = counter_now() - c0;
+		if(d < best) best = d;
+	}
+	counter_base = best;
+}
+
+static uint32_t counter_since(uint64_t c0)
+{
+	uint64_t d = counter_now() - c0;
+
+	return (uint32_t) (d > counter_base ? d - counter_base : 0);
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+	return (x > y) - (x < y);
+}
+
+//
+// report(): ordena as amostras e imprime p99 e max, com contador de
+// instrucoes o max e o pior caminho de instrucoes executado
+//
+static void report(const char *name, uint32_t ops)
+{
+	const char *unit = (counter_fd < 0) ? "ns" : "insn";
+
+	qsort(samples, ops, sizeof(samples[0]), cmp_u32);
+
+	printf("%-22s p99=%u%s max=%u%s\n", name,
+		   samples[(uint64_t) ops * 99 / 100], unit, samples[ops - 1], unit);
+}
+
+//
+// fill_deferred(): segura o lock para os uTryFree irem para a
+// fila, deixando TLSF_DRAIN_MAX nos para o proximo drain
+//
+static void fill_deferred(tlsf_t *tlsf)
+{
+	int32_t i;
+
+	for(i = 0; i < TLSF_DRAIN_MAX; i++) pending[i] = uMalloc(16 + i * 40);
+
+	TLSF_ACQUIRE_LOCK(&tlsf->lock);
+	for(i = 0; i < TLSF_DRAIN_MAX; i++) uTryFree(&reserve, pending[i]);
+	TLSF_RELEASE_LOCK(&tlsf->lock);
+}
+
+//
+// bench_drain(): caminho com a pool livre, pagando o drain inteiro
+//
+static void bench_drain(tlsf_t *tlsf)
+{
+	uint64_t c0;
+	uint32_t i;
+	void *p;
+
+	for(i = 0; i < BENCH_OPS; i++)
+	{
+		fill_deferred(tlsf);
+		c0 = counter_now();
+		p = uTryMalloc(&reserve, 16 + i % 2000);
+		samples[i] = counter_since(c0);
+		uFree(p);
+	}
+	report("uTryMalloc+drain", BENCH_OPS);
+
+	for(i = 0; i < BENCH_OPS; i++)
+	{
+		p = uMalloc(16 + i % 2000);
+		fill_deferred(tlsf);
+		c0 = counter_now();
+		uTryFree(&reserve, p);
+		samples[i] = counter_since(c0);
+	}
+	report("uTryFree+drain", BENCH_OPS);
+}
+
+//
+// bench_contended(): lock tomado, so reserva e defer_push
+//
+static void bench_contended(tlsf_t *tlsf)
+{
+	uint64_t c0;
+	uint32_t i;
+	void *p;
+
+	for(i = 0; i < BENCH_OPS; i++)
+	{
+		TLSF_ACQUIRE_LOCK(&tlsf->lock);
+		c0 = counter_now();
+		p = uTryMalloc(&reserve, RESERVE_BLOCK);
+		samples[i] = counter_since(c0);
+		uTryFree(&reserve, p);
+		TLSF_RELEASE_LOCK(&tlsf->lock);
+	}
+	report("reserve (busy)", BENCH_OPS);
+
+	for(i = 0; i < BENCH_OPS; i++)
+	{
+		p = uMalloc(16 + i % 2000);
+
+		TLSF_ACQUIRE_LOCK(&tlsf->lock);
+		c0 = counter_now();
+		uTryFree(&reserve, p);
+		samples[i] = counter_since(c0);
+		TLSF_RELEASE_LOCK(&tlsf->lock);
+
+		//o drain do proximo lock devolve o bloco para a pool
+		pool_lock(tlsf);
+		pool_unlock(tlsf);
+	}
+	report("defer_push (busy)", BENCH_OPS);
+}
+
+//
+// stress_worker(): dono do lock na maior parte do tempo
+//
+static volatile int32_t stress_stop = 0;
+
+static void *stress_worker(void *arg)
+{
+	void *live[STRESS_SLOTS] = { 0 };
+	unsigned int seed = (unsigned int) (uintptr_t) arg;
+	int32_t i;
+
+	while(!stress_stop)
+	{
+		i = rand_r(&seed) % STRESS_SLOTS;
+		if(live[i] != NULL)
+		{
+			if(*(uint32_t *) live[i] != (uint32_t) i) abort();
+			uFree(live[i]);
+			live[i] = NULL;
+		}
+		else
+		{
+			live[i] = uMalloc(8 + rand_r(&seed) % 1000);
+			if(live[i] != NULL) *(uint32_t *) live[i] = i;
+		}
+	}
+	for(i = 0; i < STRESS_SLOTS; i++) uFree(live[i]);
+	return NULL;
+}
+
+//
+// stress(): 3 threads no caminho normal e uma no uTryMalloc /
+// uTryFree, ao fim a pool, a fila e a reserva voltam ao inicio
+//
+static int32_t stress(tlsf_t *tlsf)
+{
+	pthread_t threads[STRESS_THREADS];
+	void *live[64] = { 0 };
+	unsigned int seed = 7;
+	size_t initial = tlsf->used_size;
+	uint64_t c0;
+	uint32_t worst = 0, d;
+	int32_t i, k, ok;
+
+	for(i = 0; i < STRESS_THREADS; i++)
+		pthread_create(&threads[i], NULL, stress_worker, (void *) (uintptr_t) (i + 1));
+
+	for(k = 0; k < STRESS_OPS; k++)
+	{
+		i = rand_r(&seed) % 64;
+		c0 = counter_now();
+		if(live[i] != NULL)
+		{
+			uTryFree(&reserve, live[i]);
+			live[i] = NULL;
+		}
+		else
+		{
+			live[i] = uTryMalloc(&reserve, 8 + rand_r(&seed) % 200);
+		}
+		d = counter_since(c0);
+		if(d > worst) worst = d;
+	}
+	for(i = 0; i < 64; i++) uTryFree(&reserve, live[i]);
+
+	stress_stop = 1;
+	for(i = 0; i < STRESS_THREADS; i++) pthread_join(threads[i], NULL);
+
+	//
+	// Cada aquisicao drena ate TLSF_DRAIN_MAX, entao basta tomar o
+	// lock algumas vezes para esvaziar a fila:
+	//
+	for(i = 0; i < 64; i++)
+	{
+		pool_lock(tlsf);
+		pool_unlock(tlsf);
+	}
+
+	ok = tlsf->used_size == initial &&
+		 (tlsf->defer_tail == &tlsf->defer_stub || tlsf->defer_tail->next == NULL) &&
+		 reserve.free_mask == 0xFFFFFFFF;
+
+	printf("stress %d+1 threads    max=%u%s used=%lu/%lu reserve=%08x %s\n",
+		   STRESS_THREADS, worst, (counter_fd < 0) ? "ns" : "insn", (unsigned long) tlsf->used_size,
+		   (unsigned long) initial, reserve.free_mask, ok ? "ok" : "FAILED");
+	return ok;
+}
+
+int main(void)
+{
+	tlsf_t *tlsf;
+
+	HeapInit(heap, HEAP_SIZE);
+	uReserveInit(&reserve, reserve_mem, RESERVE_BLOCK, RESERVE_COUNT);
+	tlsf = (tlsf_t *) mp;
+
+	counter_open();
+	if(counter_fd < 0) printf("perf_event_open indisponivel, medindo em ns\n");
+	counter_calibrate();
+
+	bench_drain(tlsf);
+	bench_contended(tlsf);
+	return stress(tlsf) ? 0 : 1;
+}